@@ -0,0 +1,135 @@
+#include "archive.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TAR_BLOCK_SIZE 512
+
+Archive* open_archive(const char* path) {
+	FILE* file = NULL;
+	if (strcmp(path, "-") == 0) {
+		// Keep the real stdout for the archive, status messages go to stderr from now on
+		fflush(stdout);
+		int fd = dup(STDOUT_FILENO);
+		if (fd >= 0 && dup2(STDERR_FILENO, STDOUT_FILENO) >= 0) {
+			file = fdopen(fd, "wb");
+		}
+		if (!file && fd >= 0) close(fd);
+	} else {
+		file = fopen(path, "wb");
+	}
+
+	if (!file) {
+		SDL_SetError("Couldn't open archive %s", path);
+		return NULL;
+	}
+
+	Archive* archive = malloc(sizeof(Archive));
+	if (!archive) {
+		fclose(file);
+		SDL_SetError("Out of memory");
+		return NULL;
+	}
+	archive->file = file;
+	archive->entries = 0;
+	return archive;
+}
+
+static void write_octal(char* field, size_t width, unsigned long long value) {
+	snprintf(field, width, "%0*llo", (int)width - 1, value);
+}
+
+// Splits a long name at a '/' into the 155-byte prefix and 100-byte name fields
+static bool split_ustar_name(const char* name, size_t* prefix_len) {
+	size_t len = strlen(name);
+	for (size_t i = len; i-- > 0;) {
+		if (name[i] != '/') continue;
+		if (len - i - 1 >= 100) return false;
+		if (i <= 155 && i > 0) {
+			*prefix_len = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool write_entry(Archive* archive, const char* prefix, size_t prefix_len,
+		const char* name, char type, const void* data, size_t size) {
+	char header[TAR_BLOCK_SIZE];
+	memset(header, 0, sizeof(header));
+	memcpy(header, name, strlen(name));       // name
+	write_octal(header + 100, 8, 0644);        // mode
+	write_octal(header + 108, 8, 0);           // uid
+	write_octal(header + 116, 8, 0);           // gid
+	write_octal(header + 124, 12, size);       // size
+	write_octal(header + 136, 12, (unsigned long long)time(NULL)); // mtime
+	header[156] = type;                        // type flag
+	memcpy(header + 257, "ustar", 6);          // magic
+	memcpy(header + 263, "00", 2);             // version
+	memcpy(header + 345, prefix, prefix_len);  // prefix
+
+	// Checksum is computed with its own field filled with spaces
+	memset(header + 148, ' ', 8);
+	unsigned int checksum = 0;
+	for (int i = 0; i < TAR_BLOCK_SIZE; i++) {
+		checksum += (unsigned char)header[i];
+	}
+	snprintf(header + 148, 7, "%06o", checksum);
+	header[155] = ' ';
+
+	static const char padding[TAR_BLOCK_SIZE] = { 0 };
+	size_t padding_size = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+	return fwrite(header, 1, sizeof(header), archive->file) == sizeof(header) &&
+		fwrite(data, 1, size, archive->file) == size &&
+		fwrite(padding, 1, padding_size, archive->file) == padding_size;
+}
+
+// Names that don't fit ustar go into a pax "path" record ahead of the entry
+static bool write_pax_path(Archive* archive, const char* name, const char* short_name) {
+	// The record length counts its own digits
+	size_t body = strlen(" path=\n") + strlen(name);
+	size_t len = body + 1;
+	while ((size_t)snprintf(NULL, 0, "%zu", len) + body != len) len++;
+
+	char* record = malloc(len + 1);
+	if (!record) return SDL_SetError("Out of memory");
+	snprintf(record, len + 1, "%zu path=%s\n", len, name);
+
+	bool ok = write_entry(archive, "", 0, short_name, 'x', record, len);
+	free(record);
+	return ok;
+}
+
+bool add_archive_entry(Archive* archive, const char* name, const void* data, size_t size) {
+	char short_name[100];
+	size_t prefix_len = 0;
+	bool ok = true;
+	if (strlen(name) < sizeof(short_name)) {
+		strcpy(short_name, name);
+	} else if (split_ustar_name(name, &prefix_len)) {
+		strcpy(short_name, name + prefix_len + 1);
+	} else {
+		// Readers without pax support still get the entry, under a cut short name
+		memcpy(short_name, name, sizeof(short_name) - 1);
+		short_name[sizeof(short_name) - 1] = '\0';
+		ok = write_pax_path(archive, name, short_name);
+	}
+
+	ok = ok && write_entry(archive, name, prefix_len, short_name, '0', data, size) &&
+		fflush(archive->file) == 0; // Hand every finished entry to the reader right away
+
+	if (!ok) return SDL_SetError("Couldn't write archive entry %s", name);
+	archive->entries++;
+	return true;
+}
+
+bool close_archive(Archive* archive) {
+	static const char end_blocks[2 * TAR_BLOCK_SIZE] = { 0 };
+	bool ok = fwrite(end_blocks, 1, sizeof(end_blocks), archive->file) == sizeof(end_blocks);
+	if (fclose(archive->file) != 0) ok = false;
+	free(archive);
+	if (!ok) SDL_SetError("Couldn't finish archive");
+	return ok;
+}
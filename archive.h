@@ -0,0 +1,18 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct {
+	FILE* file;
+	int entries;
+} Archive;
+
+// Streaming ustar writer, "-" writes to stdout and moves console output to stderr
+Archive* open_archive(const char* path);
+bool add_archive_entry(Archive* archive, const char* name, const void* data, size_t size);
+bool close_archive(Archive* archive);
+
+#endif /* ARCHIVE_H */
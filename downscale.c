@@ -0,0 +1,201 @@
+#include "downscale.h"
+#include "parallel.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DOWNSCALE_MIN_BAND_ROWS 16
+
+// For every output pixel, the run of source pixels it covers and how much of each
+typedef struct {
+	int* start;
+	int* count;
+	float* weights; // taps per output pixel, normalized to sum to 1
+	int taps;
+} AxisWeights;
+
+typedef struct {
+	const Uint8* src;
+	int src_pitch;
+	Uint8* dst;
+	int dst_pitch;
+	int channels;
+	int dst_width;
+	const AxisWeights* horizontal;
+	const AxisWeights* vertical;
+	int first_row;
+	int last_row;
+	bool ok;
+} DownscaleBand;
+
+static void free_axis(AxisWeights* axis) {
+	free(axis->start);
+	free(axis->count);
+	free(axis->weights);
+}
+
+static bool compute_axis(AxisWeights* axis, int src, int dst) {
+	double scale = (double)src / dst;
+	axis->taps = (int)ceil(scale) + 1;
+	axis->start = malloc(dst * sizeof(int));
+	axis->count = malloc(dst * sizeof(int));
+	axis->weights = calloc((size_t)dst * axis->taps, sizeof(float));
+	if (!axis->start || !axis->count || !axis->weights) {
+		free_axis(axis);
+		return false;
+	}
+
+	for (int i = 0; i < dst; i++) {
+		double from = i * scale, to = (i + 1) * scale;
+		int first = (int)floor(from);
+		int last = (int)ceil(to);
+		if (last > src) last = src;
+
+		axis->start[i] = first;
+		axis->count[i] = last - first;
+		for (int p = first; p < last; p++) {
+			double covered = fmin(p + 1, to) - fmax(p, from);
+			axis->weights[(size_t)i * axis->taps + (p - first)] = (float)(covered / scale);
+		}
+	}
+	return true;
+}
+
+static void filter_row_horizontal(float* out, const Uint8* src, int channels, int width, const AxisWeights* axis) {
+	for (int x = 0; x < width; x++) {
+		const float* weights = axis->weights + (size_t)x * axis->taps;
+		const Uint8* pixel = src + (size_t)axis->start[x] * channels;
+		float sum[4] = { 0, 0, 0, 0 };
+		if (channels == 4) {
+			// Colors are premultiplied so transparent pixels don't bleed into their neighbours
+			for (int t = 0; t < axis->count[x]; t++) {
+				const Uint8* p = pixel + t * 4;
+				float alpha = weights[t] * p[3];
+				sum[0] += alpha * p[0];
+				sum[1] += alpha * p[1];
+				sum[2] += alpha * p[2];
+				sum[3] += alpha;
+			}
+		} else {
+			for (int t = 0; t < axis->count[x]; t++) {
+				for (int c = 0; c < channels; c++) {
+					sum[c] += weights[t] * pixel[t * channels + c];
+				}
+			}
+		}
+		for (int c = 0; c < channels; c++) {
+			out[x * channels + c] = sum[c];
+		}
+	}
+}
+
+static int SDLCALL downscale_band(void* data) {
+	DownscaleBand* band = data;
+	size_t row_len = (size_t)band->dst_width * band->channels;
+	float* row = malloc(row_len * sizeof(float));
+	float* sum = malloc(row_len * sizeof(float));
+	band->ok = row && sum;
+
+	for (int y = band->first_row; y < band->last_row && band->ok; y++) {
+		const AxisWeights* vertical = band->vertical;
+		memset(sum, 0, row_len * sizeof(float));
+
+		// Each covered source row is reduced horizontally, then blended in with its vertical weight
+		for (int t = 0; t < vertical->count[y]; t++) {
+			const Uint8* src = band->src + (size_t)(vertical->start[y] + t) * band->src_pitch;
+			filter_row_horizontal(row, src, band->channels, band->dst_width, band->horizontal);
+
+			float weight = vertical->weights[(size_t)y * vertical->taps + t];
+			for (size_t i = 0; i < row_len; i++) {
+				sum[i] += weight * row[i];
+			}
+		}
+
+		Uint8* dst = band->dst + (size_t)y * band->dst_pitch;
+		if (band->channels == 4) {
+			for (size_t i = 0; i < row_len; i += 4) {
+				float alpha = sum[i + 3];
+				float scale = alpha > 0 ? 1.0f / alpha : 0;
+				for (int c = 0; c < 3; c++) {
+					dst[i + c] = (Uint8)fminf(sum[i + c] * scale + 0.5f, 255.0f);
+				}
+				dst[i + 3] = (Uint8)fminf(alpha + 0.5f, 255.0f);
+			}
+		} else {
+			for (size_t i = 0; i < row_len; i++) {
+				dst[i] = (Uint8)fminf(sum[i] + 0.5f, 255.0f);
+			}
+		}
+	}
+
+	free(row);
+	free(sum);
+	return 0;
+}
+
+SDL_Surface* downscale_surface(SDL_Surface* source, int width, int height) {
+	if (source->format != SDL_PIXELFORMAT_RGB24 && source->format != SDL_PIXELFORMAT_RGBA32) {
+		SDL_SetError("Only RGB24 and RGBA32 surfaces can be downscaled");
+		return NULL;
+	}
+	if (width <= 0 || height <= 0 || width > source->w || height > source->h) {
+		SDL_SetError("Invalid downscale size %dx%d", width, height);
+		return NULL;
+	}
+
+	SDL_Surface* scaled = SDL_CreateSurface(width, height, source->format);
+	if (!scaled) return NULL;
+
+	AxisWeights horizontal, vertical;
+	if (!compute_axis(&horizontal, source->w, width)) {
+		SDL_DestroySurface(scaled);
+		SDL_SetError("Out of memory");
+		return NULL;
+	}
+	if (!compute_axis(&vertical, source->h, height)) {
+		free_axis(&horizontal);
+		SDL_DestroySurface(scaled);
+		SDL_SetError("Out of memory");
+		return NULL;
+	}
+
+	int count = SDL_GetNumLogicalCPUCores();
+	if (count > height / DOWNSCALE_MIN_BAND_ROWS) count = height / DOWNSCALE_MIN_BAND_ROWS;
+	if (count < 1) count = 1;
+
+	bool ok = false;
+	DownscaleBand* bands = calloc(count, sizeof(DownscaleBand));
+	if (bands) {
+		SDL_LockSurface(source);
+		for (int i = 0; i < count; i++) {
+			bands[i].src = source->pixels;
+			bands[i].src_pitch = source->pitch;
+			bands[i].dst = scaled->pixels;
+			bands[i].dst_pitch = scaled->pitch;
+			bands[i].channels = SDL_BYTESPERPIXEL(source->format);
+			bands[i].dst_width = width;
+			bands[i].horizontal = &horizontal;
+			bands[i].vertical = &vertical;
+			bands[i].first_row = (int)((Sint64)height * i / count);
+			bands[i].last_row = (int)((Sint64)height * (i + 1) / count);
+		}
+		run_parallel(bands, sizeof(DownscaleBand), count, downscale_band);
+		SDL_UnlockSurface(source);
+
+		ok = true;
+		for (int i = 0; i < count; i++) {
+			if (!bands[i].ok) ok = false;
+		}
+		free(bands);
+	}
+
+	free_axis(&horizontal);
+	free_axis(&vertical);
+	if (!ok) {
+		SDL_DestroySurface(scaled);
+		SDL_SetError("Out of memory");
+		return NULL;
+	}
+	return scaled;
+}
@@ -0,0 +1,9 @@
+#ifndef DOWNSCALE_H
+#define DOWNSCALE_H
+
+#include <SDL3/SDL.h>
+
+// Area-averaging reduction of an RGB24 or RGBA32 surface, split into row bands across all cores
+SDL_Surface* downscale_surface(SDL_Surface* source, int width, int height);
+
+#endif /* DOWNSCALE_H */
@@ -0,0 +1,237 @@
+#include "event_log.h"
+
+#include <string.h>
+
+#define EVENT_LOG_MAGIC 0x56454349 // "ICEV"
+#define EVENT_LOG_VERSION 1
+
+static const char* event_names[LOGGED_EVENT_TYPES] = {
+	"quit", "key down", "window resized", "mouse button down", "mouse button up", "mouse motion"
+};
+
+static int logged_type(const SDL_Event* event) {
+	switch (event->type) {
+		case SDL_EVENT_QUIT: return LOGGED_QUIT;
+		case SDL_EVENT_KEY_DOWN: return LOGGED_KEY_DOWN;
+		case SDL_EVENT_WINDOW_RESIZED: return LOGGED_WINDOW_RESIZED;
+		case SDL_EVENT_MOUSE_BUTTON_DOWN: return LOGGED_MOUSE_BUTTON_DOWN;
+		case SDL_EVENT_MOUSE_BUTTON_UP: return LOGGED_MOUSE_BUTTON_UP;
+		case SDL_EVENT_MOUSE_MOTION: return LOGGED_MOUSE_MOTION;
+		default: return -1;
+	}
+}
+
+static bool write_float(SDL_IOStream* io, float value) {
+	Uint32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return SDL_WriteU32LE(io, bits);
+}
+
+static bool read_float(SDL_IOStream* io, float* value) {
+	Uint32 bits;
+	if (!SDL_ReadU32LE(io, &bits)) return false;
+	memcpy(value, &bits, sizeof(bits));
+	return true;
+}
+
+void init_live_events(EventSource* source) {
+	memset(source, 0, sizeof(EventSource));
+	source->mode = EVENT_SOURCE_LIVE;
+	source->start_ns = SDL_GetTicksNS();
+}
+
+bool start_recording(EventSource* source, const char* path, int window_width, int window_height) {
+	init_live_events(source);
+	source->io = SDL_IOFromFile(path, "wb");
+	if (!source->io) return false;
+
+	source->mode = EVENT_SOURCE_RECORD;
+	return SDL_WriteU32LE(source->io, EVENT_LOG_MAGIC) &&
+		SDL_WriteU32LE(source->io, EVENT_LOG_VERSION) &&
+		SDL_WriteS32LE(source->io, window_width) &&
+		SDL_WriteS32LE(source->io, window_height);
+}
+
+// Only the events the main loop reacts to, with just the fields it reads
+static void write_event(EventSource* source, const SDL_Event* event) {
+	int type = logged_type(event);
+	if (type < 0) return;
+
+	SDL_IOStream* io = source->io;
+	source->last_timestamp = SDL_GetTicksNS() - source->start_ns;
+	SDL_WriteU64LE(io, source->last_timestamp);
+	SDL_WriteU32LE(io, source->frame);
+	SDL_WriteU8(io, (Uint8)type);
+
+	switch (type) {
+		case LOGGED_KEY_DOWN:
+			SDL_WriteU32LE(io, event->key.key);
+			break;
+		case LOGGED_WINDOW_RESIZED:
+			SDL_WriteS32LE(io, event->window.data1);
+			SDL_WriteS32LE(io, event->window.data2);
+			break;
+		case LOGGED_MOUSE_BUTTON_DOWN:
+		case LOGGED_MOUSE_BUTTON_UP:
+			SDL_WriteU8(io, event->button.button);
+			write_float(io, event->button.x);
+			write_float(io, event->button.y);
+			break;
+		case LOGGED_MOUSE_MOTION:
+			write_float(io, event->motion.x);
+			write_float(io, event->motion.y);
+			break;
+	}
+}
+
+static bool read_event(EventSource* source) {
+	SDL_IOStream* io = source->io;
+	SDL_Event* event = &source->pending;
+	Uint64 timestamp;
+	Uint8 type;
+
+	memset(event, 0, sizeof(SDL_Event));
+	source->has_pending = false;
+	if (!SDL_ReadU64LE(io, &timestamp) || !SDL_ReadU32LE(io, &source->pending_frame) || !SDL_ReadU8(io, &type)) {
+		return false;
+	}
+
+	bool ok = true;
+	switch (type) {
+		case LOGGED_QUIT:
+			event->type = SDL_EVENT_QUIT;
+			break;
+		case LOGGED_KEY_DOWN:
+			event->type = SDL_EVENT_KEY_DOWN;
+			event->key.down = true;
+			ok = SDL_ReadU32LE(io, &event->key.key);
+			break;
+		case LOGGED_WINDOW_RESIZED:
+			event->type = SDL_EVENT_WINDOW_RESIZED;
+			ok = SDL_ReadS32LE(io, &event->window.data1) && SDL_ReadS32LE(io, &event->window.data2);
+			break;
+		case LOGGED_MOUSE_BUTTON_DOWN:
+		case LOGGED_MOUSE_BUTTON_UP:
+			event->type = type == LOGGED_MOUSE_BUTTON_DOWN ? SDL_EVENT_MOUSE_BUTTON_DOWN : SDL_EVENT_MOUSE_BUTTON_UP;
+			event->button.down = type == LOGGED_MOUSE_BUTTON_DOWN;
+			ok = SDL_ReadU8(io, &event->button.button) &&
+				read_float(io, &event->button.x) && read_float(io, &event->button.y);
+			break;
+		case LOGGED_MOUSE_MOTION:
+			event->type = SDL_EVENT_MOUSE_MOTION;
+			ok = read_float(io, &event->motion.x) && read_float(io, &event->motion.y);
+			break;
+		default:
+			ok = false;
+	}
+
+	event->common.timestamp = timestamp;
+	source->has_pending = ok;
+	return ok;
+}
+
+bool open_replay(EventSource* source, const char* path, int* window_width, int* window_height) {
+	init_live_events(source);
+	source->io = SDL_IOFromFile(path, "rb");
+	if (!source->io) return false;
+
+	source->mode = EVENT_SOURCE_REPLAY;
+	Uint32 magic, version;
+	Sint32 width, height;
+	if (!SDL_ReadU32LE(source->io, &magic) || !SDL_ReadU32LE(source->io, &version) ||
+		!SDL_ReadS32LE(source->io, &width) || !SDL_ReadS32LE(source->io, &height) ||
+		magic != EVENT_LOG_MAGIC || version != EVENT_LOG_VERSION || width <= 0 || height <= 0) {
+		return SDL_SetError("%s is not an event log", path);
+	}
+
+	*window_width = width;
+	*window_height = height;
+	if (read_event(source)) source->frame = source->pending_frame;
+	return true;
+}
+
+void start_source_events(EventSource* source, SDL_Window* window) {
+	source->window = window;
+	source->start_ns = SDL_GetTicksNS();
+}
+
+bool poll_source_event(EventSource* source, SDL_Event* event) {
+	if (source->mode != EVENT_SOURCE_REPLAY) {
+		if (!SDL_PollEvent(event)) return false;
+		if (source->mode == EVENT_SOURCE_RECORD) write_event(source, event);
+		return true;
+	}
+
+	if (!source->has_pending) {
+		if (source->replay_done) return false;
+		source->replay_done = true;
+		memset(event, 0, sizeof(SDL_Event));
+		event->type = SDL_EVENT_QUIT;
+		return true;
+	}
+	if (source->pending_frame != source->frame) return false;
+
+	*event = source->pending;
+	source->last_timestamp = event->common.timestamp;
+	if (event->type == SDL_EVENT_WINDOW_RESIZED && source->window) {
+		// The dummy driver has no real window, resize it the way the user did
+		SDL_SetWindowSize(source->window, event->window.data1, event->window.data2);
+		SDL_SyncWindow(source->window);
+	}
+	read_event(source);
+	return true;
+}
+
+void end_source_frame(EventSource* source) {
+	source->frame++;
+	// Frames without events only waited for the framerate limit, skip them
+	if (source->mode == EVENT_SOURCE_REPLAY && source->has_pending && source->pending_frame > source->frame) {
+		source->frame = source->pending_frame;
+	}
+}
+
+static void add_timing(TimingStats* stats, Uint64 elapsed_ns) {
+	stats->count++;
+	stats->total_ns += elapsed_ns;
+	if (elapsed_ns > stats->max_ns) stats->max_ns = elapsed_ns;
+}
+
+void add_event_time(EventSource* source, const SDL_Event* event, Uint64 elapsed_ns) {
+	int type = logged_type(event);
+	if (type >= 0) add_timing(&source->events[type], elapsed_ns);
+}
+
+void add_frame_time(EventSource* source, Uint64 elapsed_ns) {
+	add_timing(&source->frames, elapsed_ns);
+}
+
+static void print_timing(const char* name, const TimingStats* stats) {
+	if (stats->count == 0) return;
+	printf("  %-20s %10llu %12.2f %12.2f\n", name, (unsigned long long)stats->count,
+			(double)stats->total_ns / stats->count / 1000.0, (double)stats->max_ns / 1000.0);
+}
+
+void print_replay_report(EventSource* source) {
+	double elapsed_s = (double)(SDL_GetTicksNS() - source->start_ns) / 1e9;
+	Uint64 event_count = 0;
+	for (int i = 0; i < LOGGED_EVENT_TYPES; i++) {
+		event_count += source->events[i].count;
+	}
+
+	printf("Replay report:\n");
+	printf("  %-20s %10s %12s %12s\n", "", "count", "mean us", "max us");
+	for (int i = 0; i < LOGGED_EVENT_TYPES; i++) {
+		print_timing(event_names[i], &source->events[i]);
+	}
+	print_timing("frame render", &source->frames);
+	printf("  Recorded session %.2f s, replayed in %.3f s\n", (double)source->last_timestamp / 1e9, elapsed_s);
+	if (elapsed_s > 0) {
+		printf("  Throughput: %.0f events/s, %.0f frames/s\n",
+				event_count / elapsed_s, source->frames.count / elapsed_s);
+	}
+}
+
+void close_event_source(EventSource* source) {
+	if (source->io) SDL_CloseIO(source->io);
+	source->io = NULL;
+}
@@ -0,0 +1,65 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef enum {
+	EVENT_SOURCE_LIVE = 0,
+	EVENT_SOURCE_RECORD = 1,
+	EVENT_SOURCE_REPLAY = 2
+} EventSourceMode;
+
+typedef enum {
+	LOGGED_QUIT = 0,
+	LOGGED_KEY_DOWN = 1,
+	LOGGED_WINDOW_RESIZED = 2,
+	LOGGED_MOUSE_BUTTON_DOWN = 3,
+	LOGGED_MOUSE_BUTTON_UP = 4,
+	LOGGED_MOUSE_MOTION = 5,
+	LOGGED_EVENT_TYPES = 6
+} LoggedEventType;
+
+typedef struct {
+	Uint64 count;
+	Uint64 total_ns;
+	Uint64 max_ns;
+} TimingStats;
+
+typedef struct {
+	EventSourceMode mode;
+	SDL_IOStream* io;
+	SDL_Window* window;
+	Uint32 frame;           // Main loop iteration
+	Uint64 start_ns;
+	Uint64 last_timestamp;  // Of the last recorded or replayed event
+
+	// Replay reads one event ahead to know where the next frame starts
+	bool has_pending;
+	Uint32 pending_frame;
+	SDL_Event pending;
+	bool replay_done;
+
+	TimingStats events[LOGGED_EVENT_TYPES];
+	TimingStats frames;
+} EventSource;
+
+void init_live_events(EventSource* source);
+bool start_recording(EventSource* source, const char* path, int window_width, int window_height);
+// Reads the header only, replay needs a window of the recorded size
+bool open_replay(EventSource* source, const char* path, int* window_width, int* window_height);
+// Called right before the main loop, timestamps and replay timing start here
+void start_source_events(EventSource* source, SDL_Window* window);
+
+// Live and record modes poll SDL, replay hands out the recorded events of the current frame
+// and a final SDL_EVENT_QUIT once the log is exhausted
+bool poll_source_event(EventSource* source, SDL_Event* event);
+void end_source_frame(EventSource* source);
+
+void add_event_time(EventSource* source, const SDL_Event* event, Uint64 elapsed_ns);
+void add_frame_time(EventSource* source, Uint64 elapsed_ns);
+void print_replay_report(EventSource* source);
+void close_event_source(EventSource* source);
+
+#endif /* EVENT_LOG_H */
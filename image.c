@@ -1,13 +1,13 @@
 #include "image.h"
 
-void init_image_list(ImageList* list, int argc, char* argv[]) {
-	list->count = argc - 1;
+void init_image_list(ImageList* list, int count, char* paths[]) {
+	list->count = count;
 	list->current_index = 0;
 	list->total_cropped = 0;
 	list->image_paths = malloc(sizeof(char*) * list->count);
 
 	for (int i = 0; i < list->count; i++) {
-		list->image_paths[i] = argv[i + 1];
+		list->image_paths[i] = paths[i];
 	}
 }
 
@@ -29,3 +29,120 @@ char* get_base_filename(const char* path) {
 
 	return base;
 }
+
+SDL_Surface* load_image_surface(const char* path) {
+	SDL_Surface* surface = map_image_file(path);
+	return surface ? surface : IMG_Load(path);
+}
+
+// Prefers the surface's own format so the upload is a plain copy, then one with the same
+// alpha. An opaque surface can go into any 8-bit format, alpha is filled in as opaque
+static SDL_PixelFormat pick_texture_format(SDL_Renderer* renderer, SDL_PixelFormat source) {
+	const SDL_PixelFormat* formats = SDL_GetPointerProperty(SDL_GetRendererProperties(renderer),
+			SDL_PROP_RENDERER_TEXTURE_FORMATS_POINTER, NULL);
+	if (!formats) return SDL_PIXELFORMAT_UNKNOWN;
+
+	bool source_alpha = SDL_ISPIXELFORMAT_ALPHA(source);
+	SDL_PixelFormat fallback = SDL_PIXELFORMAT_UNKNOWN;
+	for (int i = 0; formats[i] != SDL_PIXELFORMAT_UNKNOWN; i++) {
+		if (formats[i] == source) return source;
+		if (SDL_ISPIXELFORMAT_FOURCC(formats[i]) || SDL_ISPIXELFORMAT_10BIT(formats[i]) ||
+				SDL_ISPIXELFORMAT_FLOAT(formats[i])) continue;
+
+		bool alpha = SDL_ISPIXELFORMAT_ALPHA(formats[i]);
+		if (alpha == source_alpha) {
+			if (fallback == SDL_PIXELFORMAT_UNKNOWN || SDL_ISPIXELFORMAT_ALPHA(fallback) != source_alpha) {
+				fallback = formats[i];
+			}
+		} else if (alpha && fallback == SDL_PIXELFORMAT_UNKNOWN) {
+			fallback = formats[i];
+		}
+	}
+	return fallback;
+}
+
+// SDL_CreateTextureFromSurface knows nothing about mapped bottom-up rows, flip a copy for it
+static SDL_Texture* create_texture_upright(SDL_Renderer* renderer, SDL_Surface* surface) {
+	if (!is_bottom_up_surface(surface)) {
+		return SDL_CreateTextureFromSurface(renderer, surface);
+	}
+
+	SDL_Surface* upright = SDL_DuplicateSurface(surface);
+	if (!upright) return NULL;
+
+	SDL_Texture* texture = NULL;
+	if (SDL_FlipSurface(upright, SDL_FLIP_VERTICAL)) {
+		texture = SDL_CreateTextureFromSurface(renderer, upright);
+	}
+	SDL_DestroySurface(upright);
+	return texture;
+}
+
+SDL_Texture* create_streaming_texture(SDL_Renderer* renderer, SDL_Surface* surface) {
+	SDL_PixelFormat format = pick_texture_format(renderer, surface->format);
+
+	// SDL_ConvertPixels can't apply a palette or a color key
+	if (format == SDL_PIXELFORMAT_UNKNOWN || SDL_ISPIXELFORMAT_INDEXED(surface->format) ||
+			SDL_SurfaceHasColorKey(surface)) {
+		return create_texture_upright(renderer, surface);
+	}
+
+	SDL_Texture* texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STREAMING, surface->w, surface->h);
+	if (!texture) return NULL;
+
+	void* pixels;
+	int pitch;
+	if (!SDL_LockTexture(texture, NULL, &pixels, &pitch)) {
+		SDL_DestroyTexture(texture);
+		return NULL;
+	}
+
+	// Converts straight into texture memory, no intermediate surface
+	SDL_LockSurface(surface);
+	bool ok = true;
+	if (is_bottom_up_surface(surface)) {
+		for (int y = 0; y < surface->h && ok; y++) {
+			const Uint8* src = (const Uint8*)surface->pixels + (size_t)(surface->h - 1 - y) * surface->pitch;
+			ok = SDL_ConvertPixels(surface->w, 1, surface->format, src, surface->pitch,
+					format, (Uint8*)pixels + (size_t)y * pitch, pitch);
+		}
+	} else {
+		ok = SDL_ConvertPixels(surface->w, surface->h, surface->format, surface->pixels, surface->pitch,
+				format, pixels, pitch);
+	}
+	SDL_UnlockSurface(surface);
+	SDL_UnlockTexture(texture);
+
+	if (!ok) {
+		SDL_DestroyTexture(texture);
+		return NULL;
+	}
+
+	if (SDL_ISPIXELFORMAT_ALPHA(surface->format)) {
+		SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+	}
+	return texture;
+}
+
+// Takes ownership of loaded. A decoded surface is dropped once uploaded and export decodes
+// it again on demand, a mapped one costs no memory of its own and is handed back in *surface
+SDL_Texture* upload_image_texture(SDL_Renderer* renderer, SDL_Surface* loaded, SDL_Surface** surface, int* width, int* height) {
+	*surface = NULL;
+	if (!loaded) return NULL;
+
+	SDL_Texture* texture = create_streaming_texture(renderer, loaded);
+	if (texture) {
+		*width = loaded->w;
+		*height = loaded->h;
+	}
+	if (texture && is_mapped_surface(loaded)) {
+		*surface = loaded;
+	} else {
+		SDL_DestroySurface(loaded);
+	}
+	return texture;
+}
+
+SDL_Texture* load_image_texture(SDL_Renderer* renderer, const char* path, SDL_Surface** surface, int* width, int* height) {
+	return upload_image_texture(renderer, load_image_surface(path), surface, width, height);
+}
@@ -7,6 +7,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "mapped_image.h"
+
 typedef struct {
 	char** image_paths;
 	int count;
@@ -14,8 +16,12 @@ typedef struct {
 	int total_cropped;
 } ImageList;
 
-void init_image_list(ImageList* list, int argc, char* argv[]);
+void init_image_list(ImageList* list, int count, char* paths[]);
 void free_image_list(ImageList* list);
 char* get_base_filename(const char* path);
+SDL_Surface* load_image_surface(const char* path);
+SDL_Texture* create_streaming_texture(SDL_Renderer* renderer, SDL_Surface* surface);
+SDL_Texture* upload_image_texture(SDL_Renderer* renderer, SDL_Surface* loaded, SDL_Surface** surface, int* width, int* height);
+SDL_Texture* load_image_texture(SDL_Renderer* renderer, const char* path, SDL_Surface** surface, int* width, int* height);
 
 #endif /* IMAGE_H */
@@ -13,6 +13,8 @@ SDL_Surface* create_rotated_surface(SDL_Surface* original, Rotation rotation) {
 	if (!rotated) {
 		return NULL;
 	}
+	SDL_Palette* palette = SDL_GetSurfacePalette(original);
+	if (palette) SDL_SetSurfacePalette(rotated, palette);
 
 	SDL_LockSurface(original);
 	SDL_LockSurface(rotated);
@@ -55,7 +57,187 @@ SDL_Surface* create_rotated_surface(SDL_Surface* original, Rotation rotation) {
 	return rotated;
 }
 
-void save_selections(SelectionState* state, SDL_Surface* image_surface, const char* base_name, int* total_cropped) {
+#define TRIM_BLOCK 64
+
+// Index of the first byte differing from the reference by more than tolerance, len if none.
+// Blocks are tested without branches so the inner loop compiles to SIMD compares
+static size_t first_mismatch(const Uint8* pixels, const Uint8* reference, size_t len, Uint8 tolerance) {
+	size_t i = 0;
+	for (; i + TRIM_BLOCK <= len; i += TRIM_BLOCK) {
+		Uint8 over = 0;
+		for (int j = 0; j < TRIM_BLOCK; j++) {
+			Uint8 a = pixels[i + j], b = reference[i + j];
+			over |= (Uint8)((a > b ? a - b : b - a) > tolerance);
+		}
+		if (over) break;
+	}
+	for (; i < len; i++) {
+		Uint8 a = pixels[i], b = reference[i];
+		if ((a > b ? a - b : b - a) > tolerance) return i;
+	}
+	return len;
+}
+
+// Same from the end, returns the index of the last differing byte or len if none
+static size_t last_mismatch(const Uint8* pixels, const Uint8* reference, size_t len, Uint8 tolerance) {
+	size_t i = len;
+	for (; i >= TRIM_BLOCK; i -= TRIM_BLOCK) {
+		const Uint8* block = pixels + i - TRIM_BLOCK;
+		const Uint8* block_reference = reference + i - TRIM_BLOCK;
+		Uint8 over = 0;
+		for (int j = 0; j < TRIM_BLOCK; j++) {
+			Uint8 a = block[j], b = block_reference[j];
+			over |= (Uint8)((a > b ? a - b : b - a) > tolerance);
+		}
+		if (over) break;
+	}
+	while (i > 0) {
+		i--;
+		Uint8 a = pixels[i], b = reference[i];
+		if ((a > b ? a - b : b - a) > tolerance) return i;
+	}
+	return len;
+}
+
+static void fill_pixel_row(Uint8* row, const Uint8* pixel, int bpp, int width) {
+	for (int x = 0; x < width; x++) {
+		memcpy(row + x * bpp, pixel, bpp);
+	}
+}
+
+SDL_Rect trim_background(SDL_Surface* surface, SDL_Rect rect, int tolerance) {
+	SDL_PixelFormat format = surface->format;
+	int bpp = SDL_BYTESPERPIXEL(format);
+
+	// Bytes are channels only in 8-bit-per-channel formats and in grayscale INDEX8, where the
+	// index is the gray level. Other indexed and packed formats must match exactly
+	bool channel_bytes = bpp >= 3 && bpp <= 4 && !SDL_ISPIXELFORMAT_10BIT(format) &&
+		!SDL_ISPIXELFORMAT_FLOAT(format) && !SDL_ISPIXELFORMAT_FOURCC(format);
+	bool gray_index = format == SDL_PIXELFORMAT_INDEX8 && is_grayscale_palette(SDL_GetSurfacePalette(surface));
+	if (!channel_bytes && !gray_index) {
+		tolerance = 0;
+	}
+	if (tolerance < 0) tolerance = 0;
+	if (tolerance > 255) tolerance = 255;
+
+	size_t row_len = (size_t)rect.w * bpp;
+	Uint8* top_left = malloc(row_len);
+	Uint8* bottom_right = malloc(row_len);
+	if (!top_left || !bottom_right) {
+		free(top_left);
+		free(bottom_right);
+		return rect;
+	}
+
+	SDL_LockSurface(surface);
+	size_t pitch = surface->pitch;
+	const Uint8* first = (const Uint8*)surface->pixels + rect.y * pitch + (size_t)rect.x * bpp;
+
+	// Top and left edges compare against the top-left pixel, bottom and right against the bottom-right one
+	fill_pixel_row(top_left, first, bpp, rect.w);
+	fill_pixel_row(bottom_right, first + (size_t)(rect.h - 1) * pitch + row_len - bpp, bpp, rect.w);
+
+	int top = 0, bottom = rect.h;
+	while (top < bottom && first_mismatch(first + top * pitch, top_left, row_len, tolerance) == row_len) top++;
+
+	if (top < bottom) {
+		while (bottom - 1 > top && first_mismatch(first + (size_t)(bottom - 1) * pitch, bottom_right, row_len, tolerance) == row_len) bottom--;
+
+		// Columns are narrowed row by row, each row only rescans what is still outside the content
+		int left = rect.w;
+		for (int y = top; y < bottom && left > 0; y++) {
+			size_t found = first_mismatch(first + y * pitch, top_left, (size_t)left * bpp, tolerance);
+			if (found < (size_t)left * bpp) left = (int)(found / bpp);
+		}
+		int right = left + 1;
+		for (int y = top; y < bottom && right < rect.w; y++) {
+			size_t len = (size_t)(rect.w - right) * bpp;
+			size_t found = last_mismatch(first + y * pitch + (size_t)right * bpp, bottom_right, len, tolerance);
+			if (found < len) right += (int)(found / bpp) + 1;
+		}
+
+		rect.x += left;
+		rect.y += top;
+		rect.w = right - left;
+		rect.h = bottom - top;
+	}
+	SDL_UnlockSurface(surface);
+
+	free(top_left);
+	free(bottom_right);
+	return rect;
+}
+
+// Encodes in memory and appends to the archive, or writes a file of its own
+static bool write_output(SDL_Surface* surface, const char* filename, int level, const ExportSettings* settings) {
+	if (!settings->archive) {
+		return save_png(surface, filename, level);
+	}
+
+	SDL_IOStream* buffer = SDL_IOFromDynamicMem();
+	if (!buffer) return false;
+
+	bool ok = save_png_io(surface, buffer, level);
+	if (ok) {
+		void* data = SDL_GetPointerProperty(SDL_GetIOProperties(buffer), SDL_PROP_IOSTREAM_DYNAMIC_MEMORY_POINTER, NULL);
+		ok = add_archive_entry(settings->archive, filename, data, (size_t)SDL_TellIO(buffer));
+	}
+	SDL_CloseIO(buffer);
+	return ok;
+}
+
+// Every size is scaled down from the previous, already smaller one instead of the full crop.
+// Returns how many sizes were written, a failed size is reported and the rest still go out
+static int export_sizes(SDL_Surface* crop, const char* base_name, int index, const ExportSettings* settings) {
+	SDL_Surface* level = crop;
+	int written = 0;
+
+	for (int i = 0; i < settings->size_count; i++) {
+		const OutputSize* size = &settings->sizes[i];
+		int longest = crop->w > crop->h ? crop->w : crop->h;
+		int width = crop->w, height = crop->h;
+		if (size->max_size > 0 && longest > size->max_size) {
+			width = (int)((Sint64)crop->w * size->max_size / longest);
+			height = (int)((Sint64)crop->h * size->max_size / longest);
+			if (width < 1) width = 1;
+			if (height < 1) height = 1;
+		}
+
+		if (width != level->w || height != level->h) {
+			// The downscaler works on plain 8-bit RGB(A), convert once for the whole cascade
+			SDL_Surface* source = level;
+			if (level == crop && crop->format != SDL_PIXELFORMAT_RGB24 && crop->format != SDL_PIXELFORMAT_RGBA32) {
+				bool alpha = SDL_ISPIXELFORMAT_ALPHA(crop->format) || SDL_SurfaceHasColorKey(crop);
+				source = SDL_ConvertSurface(crop, alpha ? SDL_PIXELFORMAT_RGBA32 : SDL_PIXELFORMAT_RGB24);
+			}
+			SDL_Surface* scaled = source ? downscale_surface(source, width, height) : NULL;
+			if (source != level) SDL_DestroySurface(source);
+			if (!scaled) {
+				printf("Failed to scale %s_%d to %dx%d: %s\n", base_name, index, width, height, SDL_GetError());
+				continue;
+			}
+			if (level != crop) SDL_DestroySurface(level);
+			level = scaled;
+		}
+
+		char filename[256];
+		snprintf(filename, sizeof(filename), "%s_%d%s.png", base_name, index, size->suffix);
+
+		if (write_output(level, filename, size->level, settings)) {
+			printf(settings->archive ? "Archived: %s\n" : "Saved: %s\n", filename);
+			written++;
+		} else {
+			printf("Failed to save %s: %s\n", filename, SDL_GetError());
+		}
+	}
+
+	if (level != crop) SDL_DestroySurface(level);
+	return written;
+}
+
+void save_selections(SelectionState* state, SDL_Surface* image_surface, const char* base_name, int* total_cropped, const ExportSettings* settings) {
+	if (settings->skip_output) return;
+
 	for (int i = 0; i < state->count; i++) {
 		if (!state->selections[i].active) continue;
 		
@@ -76,25 +258,36 @@ void save_selections(SelectionState* state, SDL_Surface* image_surface, const ch
 		
 		if (crop_rect.w <= 0 || crop_rect.h <= 0) continue;
 		
+		// Mapped bottom-up images store rows last to first, flip only the cropped part
+		bool bottom_up = is_bottom_up_surface(image_surface);
+		if (bottom_up) {
+			crop_rect.y = image_surface->h - crop_rect.y - crop_rect.h;
+		}
+		
+		// Trim before copying so the blit, rotation and encoder only see the content
+		if (settings->trim) {
+			crop_rect = trim_background(image_surface, crop_rect, settings->trim_tolerance);
+		}
+		
 		// Create cropped surface
 		SDL_Surface* cropped = SDL_CreateSurface(crop_rect.w, crop_rect.h, image_surface->format);
 		if (!cropped) continue;
 		
+		// Same palette on both sides makes the blit a plain copy, and the PNG keeps it
+		SDL_Palette* palette = SDL_GetSurfacePalette(image_surface);
+		if (palette) SDL_SetSurfacePalette(cropped, palette);
+		
 		SDL_BlitSurface(image_surface, &crop_rect, cropped, NULL);
+		if (bottom_up) {
+			SDL_FlipSurface(cropped, SDL_FLIP_VERTICAL);
+		}
 		
 		// Apply rotation if needed
 		SDL_Surface* final_surface = create_rotated_surface(cropped, sel->rotation);
 
-		// Generate filename
-		char filename[256];
-		snprintf(filename, sizeof(filename), "%s_%d.png", base_name, (*total_cropped) + 1);
-		
-		// Save as PNG
-		if (IMG_SavePNG(final_surface, filename)) {
-			printf("Saved: %s\n", filename);
+		// Save as PNG in every configured size, the index is used up as soon as one file exists
+		if (final_surface && export_sizes(final_surface, base_name, (*total_cropped) + 1, settings) > 0) {
 			(*total_cropped)++;
-		} else {
-			printf("Failed to save %s: %s\n", filename, SDL_GetError());
 		}
 		
 		// Cleanup
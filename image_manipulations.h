@@ -6,8 +6,23 @@
 #include <stdio.h>
 
 #include "selection.h"
+#include "png_writer.h"
+#include "mapped_image.h"
+#include "archive.h"
+#include "downscale.h"
+#include "output_size.h"
+
+typedef struct {
+	Archive* archive; // One archive entry per crop instead of one file each when set
+	bool trim;
+	int trim_tolerance; // Per channel or gray level, other indexed and packed formats match exactly
+	const OutputSize* sizes; // Largest first
+	int size_count;
+	bool skip_output; // Replays go through the motions without touching any crops on disk
+} ExportSettings;
 
 SDL_Surface* create_rotated_surface(SDL_Surface* original, Rotation rotation);
-void save_selections(SelectionState* state, SDL_Surface* image_surface, const char* base_name, int* total_cropped);
+SDL_Rect trim_background(SDL_Surface* surface, SDL_Rect rect, int tolerance);
+void save_selections(SelectionState* state, SDL_Surface* image_surface, const char* base_name, int* total_cropped, const ExportSettings* settings);
 
 #endif /* IMAGE_MANIPULATIONS_H */
\ No newline at end of file
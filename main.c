@@ -12,74 +12,147 @@
 #include "utils.h"
 #include "draw.h"
 #include "image_manipulations.h"
+#include "options.h"
+#include "event_log.h"
+
+typedef struct {
+	const char* path;
+	SDL_Surface* surface;
+	Uint64 start_ns;
+	Uint64 end_ns;
+} DecodeJob;
+
+static int SDLCALL decode_image(void* data) {
+	DecodeJob* job = data;
+	job->start_ns = SDL_GetTicksNS();
+	job->surface = load_image_surface(job->path);
+	job->end_ns = SDL_GetTicksNS();
+	return 0;
+}
+
+static SDL_Surface* finish_decode(SDL_Thread* thread, DecodeJob* job) {
+	if (thread) SDL_WaitThread(thread, NULL);
+	return job->surface;
+}
+
+static void print_step_time(const char* step, Uint64 from_ns, Uint64 to_ns) {
+	printf("  %-20s %8.2f ms\n", step, (double)(to_ns - from_ns) / SDL_NS_PER_MS);
+}
 
 int main(int argc, char* argv[]) {
-	if (argc < 2) {
-		printf("Usage: %s <image1> [image2] [image3] ...\n", argv[0]);
+	Options options;
+	if (!parse_options(&options, argc, argv)) {
+		print_usage(argv[0]);
 		return 1;
 	}
 
+	Uint64 start_ns = SDL_GetTicksNS();
+
+	ExportSettings export_settings = { NULL, options.trim, options.trim_tolerance, options.sizes, options.size_count,
+		options.replay_path != NULL };
+	if (options.archive_path) {
+		export_settings.archive = open_archive(options.archive_path);
+		if (!export_settings.archive) {
+			fprintf(stderr, "%s\n", SDL_GetError());
+			return 1;
+		}
+	}
+
+	EventSource event_source;
+	int window_width = 800, window_height = 600;
+	bool event_log_ok = true;
+	if (options.replay_path) {
+		event_log_ok = open_replay(&event_source, options.replay_path, &window_width, &window_height);
+		// Headless with the software renderer, so runs are comparable between machines
+		SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "dummy");
+	} else if (options.record_path) {
+		event_log_ok = start_recording(&event_source, options.record_path, window_width, window_height);
+	} else {
+		init_live_events(&event_source);
+	}
+	if (!event_log_ok) {
+		fprintf(stderr, "%s\n", SDL_GetError());
+		close_event_source(&event_source);
+		if (export_settings.archive) close_archive(export_settings.archive);
+		return 1;
+	}
+
+	ImageList image_list;
+	init_image_list(&image_list, options.image_count, options.image_paths);
+
+	// Decode the first image while SDL, the window and the renderer come up
+	DecodeJob first_image = { image_list.image_paths[0], NULL, 0, 0 };
+	SDL_Thread* decode_thread = SDL_CreateThread(decode_image, "decode_first_image", &first_image);
+	if (!decode_thread) decode_image(&first_image);
+
+	Uint64 setup_ns = SDL_GetTicksNS();
 	SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
+	Uint64 init_ns = SDL_GetTicksNS();
 
-	SDL_Window* window = SDL_CreateWindow("Image Cropper", 800, 600, SDL_WINDOW_RESIZABLE);
+	SDL_Window* window = SDL_CreateWindow("Image Cropper", window_width, window_height, SDL_WINDOW_RESIZABLE);
 	if (!window) {
 		fprintf(stderr, "SDL_CreateWindow Error: %s\n", SDL_GetError());
+		SDL_DestroySurface(finish_decode(decode_thread, &first_image));
+		free_image_list(&image_list);
+		if (export_settings.archive) close_archive(export_settings.archive);
+		close_event_source(&event_source);
 		SDL_Quit();
 		return 1;
 	}
+	Uint64 window_ns = SDL_GetTicksNS();
 
-	SDL_Renderer* renderer = SDL_CreateRenderer(window, NULL);
+	SDL_Renderer* renderer = SDL_CreateRenderer(window, options.replay_path ? "software" : NULL);
 	if (!renderer) {
 		fprintf(stderr, "SDL_CreateRenderer Error: %s\n", SDL_GetError());
+		SDL_DestroySurface(finish_decode(decode_thread, &first_image));
+		free_image_list(&image_list);
 		SDL_DestroyWindow(window);
+		if (export_settings.archive) close_archive(export_settings.archive);
+		close_event_source(&event_source);
 		SDL_Quit();
 		return 1;
 	}
+	Uint64 renderer_ns = SDL_GetTicksNS();
 
 	// Enable alpha blending for transparency
 	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 
-	ImageList image_list;
-	init_image_list(&image_list, argc, argv);
-
 	SDL_Texture* texture = NULL;
 	SDL_Surface* image_surface = NULL;
 	int tex_width = 0, tex_height = 0;
 	char* current_base_name = NULL;
 
-	SDL_Cursor* loading_cursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_WAIT);
-	SDL_Cursor* default_cursor =  SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_DEFAULT);
-	SDL_SetCursor(loading_cursor);
-
 	// Clear screen
 	SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255);
 	SDL_RenderClear(renderer);
 	SDL_RenderPresent(renderer);
-
-	// Load first image
-	if (image_list.count > 0) {
-		image_surface = IMG_Load(image_list.image_paths[0]);
-		if (image_surface) {
-			texture = SDL_CreateTextureFromSurface(renderer, image_surface);
-			if (texture) {
-				tex_width = image_surface->w;
-				tex_height = image_surface->h;
-				current_base_name = get_base_filename(image_list.image_paths[0]);
-			}
-		}
+	Uint64 clear_ns = SDL_GetTicksNS();
+
+	// Upload first image
+	SDL_Surface* first_surface = finish_decode(decode_thread, &first_image);
+	Uint64 decoded_ns = SDL_GetTicksNS();
+	texture = upload_image_texture(renderer, first_surface, &image_surface, &tex_width, &tex_height);
+	if (texture) {
+		current_base_name = get_base_filename(image_list.image_paths[0]);
 	}
-
-	SDL_SetCursor(default_cursor);
+	Uint64 upload_ns = SDL_GetTicksNS();
 
 	if (!texture) {
 		fprintf(stderr, "Failed to load first image\n");
 		free_image_list(&image_list);
 		SDL_DestroyRenderer(renderer);
 		SDL_DestroyWindow(window);
+		if (export_settings.archive) close_archive(export_settings.archive);
+		close_event_source(&event_source);
 		SDL_Quit();
 		return 1;
 	}
 
+	// Cursors are not needed before the first frame is on screen
+	SDL_Cursor* loading_cursor = NULL;
+	SDL_Cursor* default_cursor = NULL;
+	bool first_frame = true;
+
 	SelectionState selection_state;
 	init_selection_state(&selection_state);
 
@@ -100,11 +173,14 @@ int main(int argc, char* argv[]) {
 	const int targetFPS = 60;
 	const Uint32 frameDelay = 1000 / targetFPS;
 	bool redraw = true;
+	SDL_FPoint mouse_position = { 0, 0 }; // From events, so replays see the recorded pointer
 
+	start_source_events(&event_source, window);
 	while (running) {
 		Uint32 frameStart = SDL_GetTicks(); // Framerate limit
 		SDL_Event event;
-		while (SDL_PollEvent(&event)) {
+		while (poll_source_event(&event_source, &event)) {
+			Uint64 event_start_ns = SDL_GetTicksNS();
 			switch (event.type) {
 				case SDL_EVENT_QUIT:
 					running = false;
@@ -127,8 +203,17 @@ int main(int argc, char* argv[]) {
 							redraw = true;
 						break;
 						case SDLK_S:
+							if (current_base_name && !image_surface && selection_state.count > 0) {
+								const char* path = image_list.image_paths[image_list.current_index];
+								SDL_SetCursor(loading_cursor);
+								image_surface = load_image_surface(path);
+								SDL_SetCursor(default_cursor);
+								if (!image_surface) {
+									printf("Failed to reload %s: %s\n", path, SDL_GetError());
+								}
+							}
 							if (current_base_name && image_surface) {
-								save_selections(&selection_state, image_surface, current_base_name, &image_list.total_cropped);
+								save_selections(&selection_state, image_surface, current_base_name, &image_list.total_cropped, &export_settings);
 								clear_selections(&selection_state);
 								redraw = true;
 							}
@@ -157,13 +242,12 @@ int main(int argc, char* argv[]) {
 								if (texture) SDL_DestroyTexture(texture);
 								if (image_surface) SDL_DestroySurface(image_surface);
 								if (current_base_name) free(current_base_name);
+								image_surface = NULL;
+								current_base_name = NULL;
 								
 								SDL_SetCursor(loading_cursor);
-								image_surface = IMG_Load(image_list.image_paths[image_list.current_index]);
-								if (image_surface) {
-									texture = SDL_CreateTextureFromSurface(renderer, image_surface);
-									tex_width = image_surface->w;
-									tex_height = image_surface->h;
+								texture = load_image_texture(renderer, image_list.image_paths[image_list.current_index], &image_surface, &tex_width, &tex_height);
+								if (texture) {
 									current_base_name = get_base_filename(image_list.image_paths[image_list.current_index]);
 									printf("Loaded: %s\n", image_list.image_paths[image_list.current_index]);
 								}
@@ -179,6 +263,8 @@ int main(int argc, char* argv[]) {
 					break;
 
 				case SDL_EVENT_MOUSE_BUTTON_DOWN:
+					mouse_position.x = event.button.x;
+					mouse_position.y = event.button.y;
 					if (event.button.button == SDL_BUTTON_LEFT) {
 						float mouse_x = event.button.x;
 						float mouse_y = event.button.y;
@@ -237,6 +323,8 @@ int main(int argc, char* argv[]) {
 					break;
 
 				case SDL_EVENT_MOUSE_MOTION:
+					mouse_position.x = event.motion.x;
+					mouse_position.y = event.motion.y;
 					if(selection_state.is_resizing) {
 						SDL_FPoint norm_mouse = get_normalized_mouse(window, tex_width, tex_height, event.motion.x, event.motion.y, NULL);
 						update_resizable(&selection_state, norm_mouse);
@@ -254,8 +342,11 @@ int main(int argc, char* argv[]) {
 					}
 					break;
 			}
+			add_event_time(&event_source, &event, SDL_GetTicksNS() - event_start_ns);
 		}
 		if(redraw) {
+			Uint64 render_start_ns = SDL_GetTicksNS();
+
 			// Clear screen
 			SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255);
 			SDL_RenderClear(renderer);
@@ -301,10 +392,8 @@ int main(int argc, char* argv[]) {
 
 				// Draw current selection being dragged
 				if (selection_state.is_dragging) {
-					float mouse_x, mouse_y;
-					SDL_GetMouseState(&mouse_x, &mouse_y);
-					mouse_x = fminf(fmaxf(mouse_x, tex_dst.x), tex_dst.x + tex_dst.w);
-					mouse_y = fminf(fmaxf(mouse_y, tex_dst.y), tex_dst.y + tex_dst.h);
+					float mouse_x = fminf(fmaxf(mouse_position.x, tex_dst.x), tex_dst.x + tex_dst.w);
+					float mouse_y = fminf(fmaxf(mouse_position.y, tex_dst.y), tex_dst.y + tex_dst.h);
 
 					SDL_FRect current_rect;
 					current_rect.x = fminf(selection_state.drag_start.x, mouse_x);
@@ -320,19 +409,49 @@ int main(int argc, char* argv[]) {
 			}
 
 			SDL_RenderPresent(renderer);
+			add_frame_time(&event_source, SDL_GetTicksNS() - render_start_ns);
+
+			if (first_frame) {
+				first_frame = false;
+				loading_cursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_WAIT);
+				default_cursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_DEFAULT);
+				SDL_SetCursor(default_cursor);
+
+				if (options.startup_timing) {
+					Uint64 frame_ns = SDL_GetTicksNS();
+					printf("Startup timing:\n");
+					print_step_time("setup", start_ns, setup_ns);
+					print_step_time("SDL_Init", setup_ns, init_ns);
+					print_step_time("window", init_ns, window_ns);
+					print_step_time("renderer", window_ns, renderer_ns);
+					print_step_time("first clear", renderer_ns, clear_ns);
+					print_step_time("decode (worker)", first_image.start_ns, first_image.end_ns);
+					print_step_time("waiting for decode", clear_ns, decoded_ns);
+					print_step_time("texture upload", decoded_ns, upload_ns);
+					print_step_time("first frame", upload_ns, frame_ns);
+					print_step_time("total", start_ns, frame_ns);
+					printf("\n");
+				}
+			}
 		}
 
 		Uint32 frameTime = SDL_GetTicks() - frameStart; // Framerate limit
-		if (frameTime < frameDelay) {
+		if (frameTime < frameDelay && event_source.mode != EVENT_SOURCE_REPLAY) {
 			SDL_Delay(frameDelay - frameTime);
 		}
 		redraw = false;
+		end_source_frame(&event_source);
+	}
+
+	if (event_source.mode == EVENT_SOURCE_REPLAY) {
+		print_replay_report(&event_source);
 	}
+	close_event_source(&event_source);
 
 	// Cleanup
-	SDL_DestroyCursor(loading_cursor);
+	if(loading_cursor != NULL) SDL_DestroyCursor(loading_cursor);
 	if(resize_cursor != NULL) SDL_DestroyCursor(resize_cursor);
-	SDL_DestroyCursor(default_cursor);
+	if(default_cursor != NULL) SDL_DestroyCursor(default_cursor);
 	free_selection_state(&selection_state);
 	if (texture) SDL_DestroyTexture(texture);
 	if (image_surface) SDL_DestroySurface(image_surface);
@@ -340,6 +459,9 @@ int main(int argc, char* argv[]) {
 	free_image_list(&image_list);
 	SDL_DestroyRenderer(renderer);
 	SDL_DestroyWindow(window);
+	if (export_settings.archive && !close_archive(export_settings.archive)) {
+		fprintf(stderr, "%s\n", SDL_GetError());
+	}
 	SDL_Quit();
 
 	return 0;
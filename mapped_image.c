@@ -0,0 +1,191 @@
+#include "mapped_image.h"
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAPPING_PROPERTY "imagecutter.mapping"
+#define BOTTOM_UP_PROPERTY "imagecutter.bottom_up"
+
+typedef struct {
+	void* base;
+	size_t size;
+} Mapping;
+
+typedef struct {
+	int width;
+	int height;
+	SDL_PixelFormat format;
+	size_t offset;
+	int pitch;
+	bool bottom_up;
+} PixelLayout;
+
+static Uint32 read_u16(const Uint8* p) {
+	return p[0] | (p[1] << 8);
+}
+
+static Uint32 read_u32(const Uint8* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((Uint32)p[3] << 24);
+}
+
+static bool parse_bmp(const Uint8* data, size_t size, PixelLayout* layout) {
+	if (size < 54 || data[0] != 'B' || data[1] != 'M') return false;
+	if (read_u32(data + 14) < 40) return false; // Only BITMAPINFOHEADER and later
+
+	Sint32 width = (Sint32)read_u32(data + 18);
+	Sint32 height = (Sint32)read_u32(data + 22);
+	Uint32 bpp = read_u16(data + 28);
+	Uint32 compression = read_u32(data + 30);
+	if (compression != 0 || width <= 0 || width > INT32_MAX / 3 || height == 0 || height == INT32_MIN) return false;
+
+	// 32-bit files may carry alpha in the 4th byte, telling needs a scan of every pixel,
+	// so those are left to SDL_image
+	if (bpp != 24) return false;
+	layout->format = SDL_PIXELFORMAT_BGR24;
+
+	layout->width = width;
+	layout->height = height < 0 ? -height : height;
+	layout->bottom_up = height > 0;
+	layout->offset = read_u32(data + 10);
+	layout->pitch = ((width * 3) + 3) & ~3;
+	return true;
+}
+
+static bool read_pnm_number(const Uint8* data, size_t size, size_t* pos, int* value) {
+	while (*pos < size) {
+		if (data[*pos] == '#') {
+			while (*pos < size && data[*pos] != '\n') (*pos)++;
+		} else if (isspace(data[*pos])) {
+			(*pos)++;
+		} else {
+			break;
+		}
+	}
+
+	long number = 0;
+	size_t start = *pos;
+	while (*pos < size && isdigit(data[*pos]) && number <= INT32_MAX) {
+		number = number * 10 + (data[*pos] - '0');
+		(*pos)++;
+	}
+	*value = (int)number;
+	return *pos > start && number <= INT32_MAX;
+}
+
+// Binary PPM (P6) and PGM (P5) with 8-bit samples
+static bool parse_pnm(const Uint8* data, size_t size, PixelLayout* layout) {
+	if (size < 3 || data[0] != 'P' || (data[1] != '5' && data[1] != '6')) return false;
+
+	size_t pos = 2;
+	int width, height, maxval;
+	if (!read_pnm_number(data, size, &pos, &width) ||
+		!read_pnm_number(data, size, &pos, &height) ||
+		!read_pnm_number(data, size, &pos, &maxval)) {
+		return false;
+	}
+	if (width <= 0 || height <= 0 || maxval != 255 || pos >= size || !isspace(data[pos])) return false;
+
+	int channels = data[1] == '6' ? 3 : 1;
+	if (width > INT32_MAX / channels) return false;
+
+	layout->format = channels == 3 ? SDL_PIXELFORMAT_RGB24 : SDL_PIXELFORMAT_INDEX8;
+	layout->width = width;
+	layout->height = height;
+	layout->bottom_up = false;
+	layout->offset = pos + 1;
+	layout->pitch = width * channels;
+	return true;
+}
+
+static void SDLCALL unmap_file(void* userdata, void* value) {
+	(void)userdata;
+	Mapping* mapping = value;
+	munmap(mapping->base, mapping->size);
+	free(mapping);
+}
+
+static bool set_grayscale_palette(SDL_Surface* surface) {
+	SDL_Palette* palette = SDL_CreatePalette(256);
+	if (!palette) return false;
+
+	SDL_Color colors[256];
+	for (int i = 0; i < 256; i++) {
+		colors[i] = (SDL_Color){ (Uint8)i, (Uint8)i, (Uint8)i, 255 };
+	}
+	SDL_SetPaletteColors(palette, colors, 0, 256);
+	bool ok = SDL_SetSurfacePalette(surface, palette);
+	SDL_DestroyPalette(palette);
+	return ok;
+}
+
+bool is_grayscale_palette(const SDL_Palette* palette) {
+	if (!palette || palette->ncolors != 256) return false;
+	for (int i = 0; i < 256; i++) {
+		const SDL_Color* color = &palette->colors[i];
+		if (color->r != i || color->g != i || color->b != i || color->a != 255) return false;
+	}
+	return true;
+}
+
+SDL_Surface* map_image_file(const char* path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+
+	// Read-only, pages come straight from the page cache and nothing counts against commit
+	size_t size = (size_t)st.st_size;
+	void* base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) return NULL;
+
+	PixelLayout layout;
+	if (!parse_bmp(base, size, &layout) && !parse_pnm(base, size, &layout)) {
+		munmap(base, size);
+		return NULL;
+	}
+	if (layout.offset > size || (size - layout.offset) / layout.pitch < (size_t)layout.height) {
+		munmap(base, size);
+		return NULL;
+	}
+
+	Mapping* mapping = malloc(sizeof(Mapping));
+	SDL_Surface* surface = SDL_CreateSurfaceFrom(layout.width, layout.height, layout.format,
+			(Uint8*)base + layout.offset, layout.pitch);
+	if (!mapping || !surface) {
+		if (surface) SDL_DestroySurface(surface);
+		free(mapping);
+		munmap(base, size);
+		return NULL;
+	}
+
+	// The mapping lives exactly as long as the surface
+	mapping->base = base;
+	mapping->size = size;
+	SDL_PropertiesID props = SDL_GetSurfaceProperties(surface);
+	SDL_SetPointerPropertyWithCleanup(props, MAPPING_PROPERTY, mapping, unmap_file, NULL);
+	SDL_SetBooleanProperty(props, BOTTOM_UP_PROPERTY, layout.bottom_up);
+
+	if (layout.format == SDL_PIXELFORMAT_INDEX8 && !set_grayscale_palette(surface)) {
+		SDL_DestroySurface(surface);
+		return NULL;
+	}
+	return surface;
+}
+
+bool is_mapped_surface(SDL_Surface* surface) {
+	return SDL_GetPointerProperty(SDL_GetSurfaceProperties(surface), MAPPING_PROPERTY, NULL) != NULL;
+}
+
+bool is_bottom_up_surface(SDL_Surface* surface) {
+	return SDL_GetBooleanProperty(SDL_GetSurfaceProperties(surface), BOTTOM_UP_PROPERTY, false);
+}
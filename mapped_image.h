@@ -0,0 +1,16 @@
+#ifndef MAPPED_IMAGE_H
+#define MAPPED_IMAGE_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+
+// Wraps the pixels of a 24-bit BMP or 8-bit PPM/PGM file in place, NULL for anything else
+SDL_Surface* map_image_file(const char* path);
+bool is_mapped_surface(SDL_Surface* surface);
+// Bottom-up BMPs are mapped as stored, row 0 of the surface is the last image row
+bool is_bottom_up_surface(SDL_Surface* surface);
+// The 256 entry ramp PGM files are mapped with and SDL_image gives 8-bit grayscale images,
+// index and gray level are the same
+bool is_grayscale_palette(const SDL_Palette* palette);
+
+#endif /* MAPPED_IMAGE_H */
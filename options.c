@@ -0,0 +1,150 @@
+#include "options.h"
+#include "png_writer.h"
+
+void print_usage(const char* program) {
+	printf("Usage: %s [options] <image1> [image2] [image3] ...\n\
+Options:\n\
+  --startup-timing   Print how long each startup step took\n\
+  --archive <file>   Write all crops into one tar archive, '-' for stdout\n\
+  --record <file>    Record the input events of the session\n\
+  --replay <file>    Replay recorded events headlessly as fast as possible and report timings\n\
+  --trim             Cut uniform background borders off every crop\n\
+  --trim-tolerance <n>  Per channel difference 0-255 still counted as background (default %d),\n\
+                     16-bit and color palette images only trim exact matches\n\
+  --size <max|full>[:suffix[:level]]  Save every crop with its longest side at most max,\n\
+                     repeatable, default is one full resolution copy\n", program, DEFAULT_TRIM_TOLERANCE);
+}
+
+// <max|full>[:suffix[:level]], e.g. "1024:_preview" or "256:_thumb:9"
+static bool parse_output_size(OutputSize* size, const char* spec) {
+	char* end;
+	if (strncmp(spec, "full", 4) == 0) {
+		size->max_size = 0;
+		end = (char*)spec + 4;
+	} else {
+		long max_size = strtol(spec, &end, 10);
+		if (end == spec || max_size <= 0 || max_size > 1 << 20) return false;
+		size->max_size = (int)max_size;
+	}
+
+	size->level = PNG_DEFAULT_LEVEL;
+	if (size->max_size > 0) {
+		snprintf(size->suffix, sizeof(size->suffix), "_%d", size->max_size);
+	} else {
+		size->suffix[0] = '\0';
+	}
+	if (*end == '\0') return true;
+	if (*end != ':') return false;
+
+	const char* suffix = end + 1;
+	const char* level = strchr(suffix, ':');
+	size_t suffix_len = level ? (size_t)(level - suffix) : strlen(suffix);
+	if (suffix_len >= sizeof(size->suffix) || memchr(suffix, '/', suffix_len)) return false;
+	memcpy(size->suffix, suffix, suffix_len);
+	size->suffix[suffix_len] = '\0';
+
+	if (level) {
+		long value = strtol(level + 1, &end, 10);
+		if (end == level + 1 || *end != '\0' || value < 0 || value > 9) return false;
+		size->level = (int)value;
+	}
+	return true;
+}
+
+// Full resolution sorts as the largest
+static int compare_output_sizes(const void* a, const void* b) {
+	int size_a = ((const OutputSize*)a)->max_size, size_b = ((const OutputSize*)b)->max_size;
+	if (size_a == 0) size_a = INT32_MAX;
+	if (size_b == 0) size_b = INT32_MAX;
+	return (size_a < size_b) - (size_a > size_b);
+}
+
+// Takes the argument after the option at *i, what names it in the error when it's missing
+static const char* option_value(int argc, char* argv[], int* i, const char* what) {
+	if (*i + 1 >= argc) {
+		fprintf(stderr, "%s requires %s\n", argv[*i], what);
+		return NULL;
+	}
+	return argv[++*i];
+}
+
+// Options come first, everything from the first non-option argument on is an image
+bool parse_options(Options* options, int argc, char* argv[]) {
+	options->startup_timing = false;
+	options->archive_path = NULL;
+	options->record_path = NULL;
+	options->replay_path = NULL;
+	options->trim = false;
+	options->trim_tolerance = DEFAULT_TRIM_TOLERANCE;
+	options->size_count = 0;
+	options->image_paths = NULL;
+	options->image_count = 0;
+
+	int i = 1;
+	for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+		if (strcmp(argv[i], "--") == 0) {
+			i++;
+			break;
+		} else if (strcmp(argv[i], "--startup-timing") == 0) {
+			options->startup_timing = true;
+		} else if (strcmp(argv[i], "--archive") == 0) {
+			options->archive_path = option_value(argc, argv, &i, "a file");
+			if (!options->archive_path) return false;
+		} else if (strcmp(argv[i], "--record") == 0) {
+			options->record_path = option_value(argc, argv, &i, "a file");
+			if (!options->record_path) return false;
+		} else if (strcmp(argv[i], "--replay") == 0) {
+			options->replay_path = option_value(argc, argv, &i, "a file");
+			if (!options->replay_path) return false;
+		} else if (strcmp(argv[i], "--trim") == 0) {
+			options->trim = true;
+		} else if (strcmp(argv[i], "--trim-tolerance") == 0) {
+			const char* value = option_value(argc, argv, &i, "a value");
+			if (!value) return false;
+			char* end;
+			long tolerance = strtol(value, &end, 10);
+			if (end == value || *end != '\0' || tolerance < 0 || tolerance > 255) {
+				fprintf(stderr, "Invalid trim tolerance: %s\n", value);
+				return false;
+			}
+			options->trim = true;
+			options->trim_tolerance = (int)tolerance;
+		} else if (strcmp(argv[i], "--size") == 0) {
+			const char* value = option_value(argc, argv, &i, "a value");
+			if (!value) return false;
+			if (options->size_count == MAX_OUTPUT_SIZES) {
+				fprintf(stderr, "At most %d output sizes are supported\n", MAX_OUTPUT_SIZES);
+				return false;
+			}
+			if (!parse_output_size(&options->sizes[options->size_count], value)) {
+				fprintf(stderr, "Invalid output size: %s\n", value);
+				return false;
+			}
+			options->size_count++;
+		} else {
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			return false;
+		}
+	}
+
+	if (options->record_path && options->replay_path) {
+		fprintf(stderr, "--record and --replay can't be used together\n");
+		return false;
+	}
+	// Replays don't save crops, opening the archive would only truncate it
+	if (options->replay_path && options->archive_path) {
+		fprintf(stderr, "--archive and --replay can't be used together\n");
+		return false;
+	}
+
+	if (options->size_count == 0) {
+		parse_output_size(&options->sizes[0], "full");
+		options->size_count = 1;
+	}
+	// Largest first, so each size can be scaled down from the one before it
+	qsort(options->sizes, options->size_count, sizeof(OutputSize), compare_output_sizes);
+
+	options->image_paths = argv + i;
+	options->image_count = argc - i;
+	return options->image_count > 0;
+}
@@ -0,0 +1,29 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "output_size.h"
+
+#define DEFAULT_TRIM_TOLERANCE 24
+
+typedef struct {
+	bool startup_timing;
+	const char* archive_path;
+	const char* record_path;
+	const char* replay_path;
+	bool trim;
+	int trim_tolerance;
+	OutputSize sizes[MAX_OUTPUT_SIZES];
+	int size_count;
+	char** image_paths;
+	int image_count;
+} Options;
+
+bool parse_options(Options* options, int argc, char* argv[]);
+void print_usage(const char* program);
+
+#endif /* OPTIONS_H */
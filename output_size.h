@@ -0,0 +1,12 @@
+#ifndef OUTPUT_SIZE_H
+#define OUTPUT_SIZE_H
+
+#define MAX_OUTPUT_SIZES 8
+
+typedef struct {
+	int max_size;     // Longest side in pixels, 0 keeps the full resolution
+	char suffix[32];  // Appended to the file name before .png
+	int level;        // zlib compression level
+} OutputSize;
+
+#endif /* OUTPUT_SIZE_H */
@@ -0,0 +1,17 @@
+#include "parallel.h"
+
+#include <stdlib.h>
+
+void run_parallel(void* jobs, size_t job_size, int count, SDL_ThreadFunction fn) {
+	Uint8* job = jobs;
+	SDL_Thread** threads = calloc(count, sizeof(SDL_Thread*));
+	for (int i = 1; i < count; i++) {
+		if (threads) threads[i] = SDL_CreateThread(fn, "worker", job + i * job_size);
+		if (!threads || !threads[i]) fn(job + i * job_size);
+	}
+	fn(job);
+	for (int i = 1; i < count && threads; i++) {
+		if (threads[i]) SDL_WaitThread(threads[i], NULL);
+	}
+	free(threads);
+}
@@ -0,0 +1,9 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <SDL3/SDL.h>
+
+// Runs fn on every job, one thread each, the calling thread takes the first job
+void run_parallel(void* jobs, size_t job_size, int count, SDL_ThreadFunction fn);
+
+#endif /* PARALLEL_H */
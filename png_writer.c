@@ -0,0 +1,334 @@
+#include "png_writer.h"
+#include "mapped_image.h"
+#include "parallel.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+// Smaller bands lose more ratio to the flush between them than they win in speed
+#define PNG_MIN_BAND_BYTES (256 * 1024)
+// Keeps every band's input and deflate output within zlib's 32-bit counters
+#define PNG_MAX_BAND_BYTES (256 * 1024 * 1024)
+#define PNG_WINDOW_SIZE 32768
+
+#define PNG_COLOR_GRAY 0
+#define PNG_COLOR_RGB 2
+#define PNG_COLOR_PALETTE 3
+#define PNG_COLOR_RGBA 6
+
+typedef struct {
+	Uint8 color_type;
+	Uint8 plte[256 * 3];
+	size_t plte_len;
+	Uint8 trns[256];
+	size_t trns_len;
+} PngColors;
+
+typedef struct {
+	const Uint8* pixels;
+	const Uint8* zero_row;
+	Uint8* filtered; // Whole image, one filter type byte + row_bytes per row
+	int pitch;
+	int row_bytes;
+	int bpp;
+	int first_row;
+	int last_row;
+	int level;
+	bool last;
+
+	Uint8* out;
+	size_t out_size;
+	uLong adler;
+	bool ok;
+} PngBand;
+
+static int paeth(int a, int b, int c) {
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if (pa <= pb && pa <= pc) return a;
+	return pb <= pc ? b : c;
+}
+
+static Uint8 filter_byte(int type, int x, int a, int b, int c) {
+	switch (type) {
+		case 1: return (Uint8)(x - a);
+		case 2: return (Uint8)(x - b);
+		case 3: return (Uint8)(x - ((a + b) >> 1));
+		case 4: return (Uint8)(x - paeth(a, b, c));
+		default: return (Uint8)x;
+	}
+}
+
+// Picks the filter with the smallest sum of absolute differences, like libpng does
+static void filter_row(Uint8* dst, const Uint8* row, const Uint8* prev, int row_bytes, int bpp) {
+	unsigned long sums[5] = { 0 };
+	for (int i = 0; i < row_bytes; i++) {
+		int a = i >= bpp ? row[i - bpp] : 0;
+		int c = i >= bpp ? prev[i - bpp] : 0;
+		int b = prev[i], x = row[i];
+		sums[0] += abs((Sint8)x);
+		sums[1] += abs((Sint8)(x - a));
+		sums[2] += abs((Sint8)(x - b));
+		sums[3] += abs((Sint8)(x - ((a + b) >> 1)));
+		sums[4] += abs((Sint8)(x - paeth(a, b, c)));
+	}
+
+	int best = 0;
+	for (int type = 1; type < 5; type++) {
+		if (sums[type] < sums[best]) best = type;
+	}
+
+	dst[0] = (Uint8)best;
+	for (int i = 0; i < row_bytes; i++) {
+		int a = i >= bpp ? row[i - bpp] : 0;
+		int c = i >= bpp ? prev[i - bpp] : 0;
+		dst[i + 1] = filter_byte(best, row[i], a, prev[i], c);
+	}
+}
+
+static int SDLCALL filter_band(void* data) {
+	PngBand* band = data;
+	size_t stride = (size_t)band->row_bytes + 1;
+	for (int y = band->first_row; y < band->last_row; y++) {
+		const Uint8* row = band->pixels + (size_t)y * band->pitch;
+		const Uint8* prev = y > 0 ? row - band->pitch : band->zero_row;
+		filter_row(band->filtered + y * stride, row, prev, band->row_bytes, band->bpp);
+	}
+	return 0;
+}
+
+// Each band is a raw deflate stream primed with the tail of the previous band,
+// ended with a sync flush so the bands concatenate into one zlib stream (as pigz does)
+static int SDLCALL deflate_band(void* data) {
+	PngBand* band = data;
+	size_t stride = (size_t)band->row_bytes + 1;
+	size_t start = band->first_row * stride;
+	size_t len = (band->last_row - band->first_row) * stride;
+	const Uint8* in = band->filtered + start;
+
+	band->ok = false;
+	band->adler = adler32(1L, in, (uInt)len);
+
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+	if (deflateInit2(&zs, band->level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		return 0;
+	}
+
+	if (start > 0) {
+		size_t dict = start < PNG_WINDOW_SIZE ? start : PNG_WINDOW_SIZE;
+		deflateSetDictionary(&zs, in - dict, (uInt)dict);
+	}
+
+	size_t bound = deflateBound(&zs, len) + 64; // Room for the sync flush marker
+	band->out = malloc(bound);
+	if (band->out) {
+		zs.next_in = (Bytef*)in;
+		zs.avail_in = (uInt)len;
+		zs.next_out = band->out;
+		zs.avail_out = (uInt)bound;
+		int ret = deflate(&zs, band->last ? Z_FINISH : Z_SYNC_FLUSH);
+		band->ok = band->last ? ret == Z_STREAM_END : (ret == Z_OK && zs.avail_out > 0);
+		band->out_size = bound - zs.avail_out;
+	}
+	deflateEnd(&zs);
+	return 0;
+}
+
+static void put_u32(Uint8* dst, Uint32 value) {
+	dst[0] = (Uint8)(value >> 24);
+	dst[1] = (Uint8)(value >> 16);
+	dst[2] = (Uint8)(value >> 8);
+	dst[3] = (Uint8)value;
+}
+
+static bool write_chunk_start(SDL_IOStream* dst, const char* type, size_t len, uLong* crc) {
+	Uint8 header[8];
+	put_u32(header, (Uint32)len);
+	memcpy(header + 4, type, 4);
+	*crc = crc32(0L, header + 4, 4);
+	return SDL_WriteIO(dst, header, sizeof(header)) == sizeof(header);
+}
+
+static bool write_chunk_data(SDL_IOStream* dst, const Uint8* data, size_t len, uLong* crc) {
+	if (len == 0) return true; // crc32() treats a NULL buffer as a reset
+	*crc = crc32(*crc, data, (uInt)len);
+	return SDL_WriteIO(dst, data, len) == len;
+}
+
+static bool write_chunk(SDL_IOStream* dst, const char* type, const Uint8* data, size_t len) {
+	uLong crc;
+	return write_chunk_start(dst, type, len, &crc) &&
+		write_chunk_data(dst, data, len, &crc) &&
+		SDL_WriteU32BE(dst, (Uint32)crc);
+}
+
+static Uint8 zlib_level_flag(int level) {
+	if (level < 0 || level == 6) return 2;
+	if (level < 2) return 0;
+	return level < 6 ? 1 : 3;
+}
+
+static bool write_png_data(SDL_Surface* surface, SDL_IOStream* dst, int level, const PngColors* colors) {
+	static const Uint8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+	int bpp = colors->color_type == PNG_COLOR_RGBA ? 4 : colors->color_type == PNG_COLOR_RGB ? 3 : 1;
+	int row_bytes = surface->w * bpp;
+	size_t stride = (size_t)row_bytes + 1;
+	size_t total = stride * surface->h;
+
+	int count = SDL_GetNumLogicalCPUCores();
+	if ((size_t)count > total / PNG_MIN_BAND_BYTES) count = (int)(total / PNG_MIN_BAND_BYTES);
+	if ((size_t)count < total / PNG_MAX_BAND_BYTES + 1) count = (int)(total / PNG_MAX_BAND_BYTES + 1);
+	if (count > surface->h) count = surface->h;
+	if (count < 1) count = 1;
+
+	Uint8* filtered = malloc(total);
+	Uint8* zero_row = calloc(1, row_bytes);
+	PngBand* bands = calloc(count, sizeof(PngBand));
+	if (!filtered || !zero_row || !bands) {
+		free(filtered);
+		free(zero_row);
+		free(bands);
+		return SDL_SetError("Out of memory");
+	}
+
+	for (int i = 0; i < count; i++) {
+		bands[i].pixels = surface->pixels;
+		bands[i].zero_row = zero_row;
+		bands[i].filtered = filtered;
+		bands[i].pitch = surface->pitch;
+		bands[i].row_bytes = row_bytes;
+		bands[i].bpp = bpp;
+		bands[i].first_row = (int)((Sint64)surface->h * i / count);
+		bands[i].last_row = (int)((Sint64)surface->h * (i + 1) / count);
+		bands[i].level = level;
+		bands[i].last = i == count - 1;
+	}
+
+	// Every band needs the filtered tail of the one before it, so filter everything first
+	run_parallel(bands, sizeof(PngBand), count, filter_band);
+	run_parallel(bands, sizeof(PngBand), count, deflate_band);
+
+	bool ok = true;
+	uLong adler = 1L;
+	for (int i = 0; i < count; i++) {
+		if (!bands[i].ok) ok = false;
+		size_t len = (bands[i].last_row - bands[i].first_row) * stride;
+		adler = adler32_combine(adler, bands[i].adler, (z_off_t)len);
+	}
+
+	Uint8 ihdr[13];
+	put_u32(ihdr, surface->w);
+	put_u32(ihdr + 4, surface->h);
+	ihdr[8] = 8;                 // Bit depth
+	ihdr[9] = colors->color_type;
+	ihdr[10] = ihdr[11] = ihdr[12] = 0;
+
+	Uint8 zlib_header[2] = { 0x78, (Uint8)(zlib_level_flag(level) << 6) };
+	zlib_header[1] += 31 - (zlib_header[0] * 256 + zlib_header[1]) % 31;
+	Uint8 zlib_trailer[4];
+	put_u32(zlib_trailer, (Uint32)adler);
+
+	if (!ok) {
+		SDL_SetError("deflate failed");
+	} else {
+		ok = SDL_WriteIO(dst, signature, sizeof(signature)) == sizeof(signature) &&
+			write_chunk(dst, "IHDR", ihdr, sizeof(ihdr)) &&
+			(colors->plte_len == 0 || write_chunk(dst, "PLTE", colors->plte, colors->plte_len)) &&
+			(colors->trns_len == 0 || write_chunk(dst, "tRNS", colors->trns, colors->trns_len));
+
+		// One IDAT per band, the zlib header and trailer ride along with the first and last
+		for (int i = 0; i < count && ok; i++) {
+			size_t len = bands[i].out_size;
+			if (i == 0) len += sizeof(zlib_header);
+			if (bands[i].last) len += sizeof(zlib_trailer);
+
+			uLong crc;
+			ok = write_chunk_start(dst, "IDAT", len, &crc) &&
+				(i != 0 || write_chunk_data(dst, zlib_header, sizeof(zlib_header), &crc)) &&
+				write_chunk_data(dst, bands[i].out, bands[i].out_size, &crc) &&
+				(!bands[i].last || write_chunk_data(dst, zlib_trailer, sizeof(zlib_trailer), &crc)) &&
+				SDL_WriteU32BE(dst, (Uint32)crc);
+		}
+
+		ok = ok && write_chunk(dst, "IEND", NULL, 0);
+	}
+
+	for (int i = 0; i < count; i++) {
+		free(bands[i].out);
+	}
+	free(bands);
+	free(zero_row);
+	free(filtered);
+	return ok;
+}
+
+// 8-bit indexed surfaces are written as they are, as grayscale when the palette is the
+// plain gray ramp, everything else goes out as RGB or RGBA
+static bool pick_png_colors(SDL_Surface* surface, PngColors* colors) {
+	colors->plte_len = 0;
+	colors->trns_len = 0;
+
+	SDL_Palette* palette = SDL_GetSurfacePalette(surface);
+	if (surface->format != SDL_PIXELFORMAT_INDEX8 || !palette || palette->ncolors > 256) {
+		bool alpha = SDL_ISPIXELFORMAT_ALPHA(surface->format) || SDL_SurfaceHasColorKey(surface);
+		colors->color_type = alpha ? PNG_COLOR_RGBA : PNG_COLOR_RGB;
+		return false;
+	}
+
+	Uint32 key;
+	bool has_key = SDL_GetSurfaceColorKey(surface, &key);
+	if (!has_key && is_grayscale_palette(palette)) {
+		colors->color_type = PNG_COLOR_GRAY;
+		return true;
+	}
+
+	colors->color_type = PNG_COLOR_PALETTE;
+	for (int i = 0; i < palette->ncolors; i++) {
+		const SDL_Color* color = &palette->colors[i];
+		Uint8 alpha = has_key && key == (Uint32)i ? 0 : color->a;
+		colors->plte[i * 3] = color->r;
+		colors->plte[i * 3 + 1] = color->g;
+		colors->plte[i * 3 + 2] = color->b;
+		colors->trns[i] = alpha;
+		if (alpha != 255) colors->trns_len = i + 1; // Entries past the last one are opaque
+	}
+	colors->plte_len = (size_t)palette->ncolors * 3;
+	return true;
+}
+
+bool save_png_io(SDL_Surface* surface, SDL_IOStream* dst, int level) {
+	if (!surface || !dst) {
+		return SDL_SetError("Invalid surface or stream");
+	}
+
+	PngColors colors;
+	SDL_Surface* converted = surface;
+	if (!pick_png_colors(surface, &colors)) {
+		SDL_PixelFormat format = colors.color_type == PNG_COLOR_RGBA ? SDL_PIXELFORMAT_RGBA32 : SDL_PIXELFORMAT_RGB24;
+		if (surface->format != format) {
+			converted = SDL_ConvertSurface(surface, format);
+			if (!converted) return false;
+		}
+	}
+
+	SDL_LockSurface(converted);
+	bool ok = write_png_data(converted, dst, level, &colors);
+	SDL_UnlockSurface(converted);
+
+	if (converted != surface) {
+		SDL_DestroySurface(converted);
+	}
+	return ok;
+}
+
+bool save_png(SDL_Surface* surface, const char* filename, int level) {
+	SDL_IOStream* dst = SDL_IOFromFile(filename, "wb");
+	if (!dst) return false;
+
+	bool ok = save_png_io(surface, dst, level);
+	if (!SDL_CloseIO(dst)) ok = false;
+	return ok;
+}
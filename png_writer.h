@@ -0,0 +1,13 @@
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+
+#define PNG_DEFAULT_LEVEL -1 // zlib default compression
+
+// Filters and deflates row bands on all cores, output is a single regular PNG
+bool save_png_io(SDL_Surface* surface, SDL_IOStream* dst, int level);
+bool save_png(SDL_Surface* surface, const char* filename, int level);
+
+#endif /* PNG_WRITER_H */